@@ -0,0 +1,242 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Grammar.h"
+
+/// @brief Pre-scoped identifiers
+
+using std::atomic;
+using std::list;
+using std::lock_guard;
+using std::mutex;
+using std::pair;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+/// @typedef cached_parse_t : result of parsing a span of terminal tokens when
+///     starting from a given parser state
+struct cached_parse_t {
+    string rrd;              // Reductions performed while parsing the span
+    vector<unsigned> stack;  // States left above the entry state (groups only)
+};
+
+/// @typedef cache_stats_t : snapshot of the counters kept by a Parse_Cache
+struct cache_stats_t {
+    size_t hits;          // Whole-input lookups answered from the cache
+    size_t misses;        // Whole-input lookups that had to be parsed
+    size_t group_hits;    // Bracketed-group lookups answered from the cache
+    size_t group_misses;  // Bracketed-group lookups that had to be parsed
+    size_t entries;       // Entries currently stored
+};
+
+/// @typedef Span_Hasher : polynomial prefix hashes over a terminal id sequence
+///     so that the hash of any contiguous span costs O(1)
+class Span_Hasher {
+public:
+    void build(const vector<unsigned>& ids) {
+        prefix.assign(ids.size() + 1, 0);
+        power.assign(ids.size() + 1, 1);
+
+        for (size_t i = 0; i < ids.size(); ++i) {
+            prefix[i + 1] = prefix[i] * BASE + ids[i] + 1;
+            power[i + 1]  = power[i] * BASE;
+        }
+    }
+
+    /// @brief Hash of ids in [first, last)
+    uint64_t span(size_t first, size_t last) const {
+        return prefix[last] - prefix[first] * power[last - first];
+    }
+
+private:
+    static const uint64_t BASE = 0x100000001b3ULL;  // Odd 64-bit multiplier
+
+    vector<uint64_t> prefix;  // prefix[i] is the hash of ids [0, i)
+    vector<uint64_t> power;   // power[i] is BASE^i
+};
+
+/// @typedef Parse_Cache : bounded LRU cache of parse results keyed by the
+///     parser state a span of terminal ids is parsed from
+/// @note Whole inputs are stored with entry state 0, which no shift can reach.
+///     Bracketed groups are stored with the state reached by shifting their
+///     opening terminal, so a hit can be replayed inside any larger input.
+///     All members are safe to call from concurrent threads. Entries are split
+///     by key over independently locked shards, each with its own LRU order, so
+///     concurrent lookups only contend when they land in the same shard.
+///     Eviction is per shard, so the least recently used entry overall is not
+///     always the one evicted.
+class Parse_Cache {
+public:
+    Parse_Cache(const Grammar& g, size_t capacity)
+        : shards(std::clamp<size_t>(capacity, 1, MAX_SHARDS)),
+          closer(g.num_terms() + 1, -1) {
+        // Spread the capacity over the shards, rounding up
+        for (shard_t& shard : shards) {
+            shard.capacity = (capacity + shards.size() - 1) / shards.size();
+        }
+
+        // Register the bracket pairs that exist in the grammar
+        const pair<string, string> BRACKETS[] = {
+            {"(", ")"}, {"[", "]"}, {"{", "}"}
+        };
+
+        for (const auto& [open, close] : BRACKETS) {
+            int open_idx  = g.has_terminal(open);
+            int close_idx = g.has_terminal(close);
+
+            if (open_idx != -1 && close_idx != -1) {
+                closer[open_idx] = close_idx;
+            }
+        }
+    }
+
+    /// @brief Pair each opening bracket with its matching closing bracket
+    /// @return for every position, the position of its closer, or -1
+    vector<int> match_groups(const vector<unsigned>& ids) const {
+        vector<int> match(ids.size(), -1);
+        vector<size_t> open;  // Positions of unmatched opening brackets
+
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (closer[ids[i]] != -1) {
+                open.push_back(i);
+            } else if (!open.empty() && closer[ids[open.back()]] == (int)ids[i]) {
+                match[open.back()] = (int)i;
+                open.pop_back();
+            }
+        }
+
+        return match;
+    }
+
+    /// @brief Look up the result of parsing ids [first, last) from state
+    /// @param hash : Span_Hasher::span(first, last) for the ids
+    /// @return whether out was filled from the cache
+    bool find(
+        unsigned state, const vector<unsigned>& ids, size_t first, size_t last,
+        uint64_t hash, cached_parse_t& out
+    ) {
+        uint64_t k = key(state, hash);
+        shard_t& shard = shard_for(k);
+        counters_t& counters = state == 0 ? whole : group;
+
+        {
+            lock_guard<mutex> lock(shard.entries_mutex);
+            auto it = shard.index.find(k);
+
+            if (
+                it != shard.index.end() && it->second->state == state &&
+                std::equal(
+                    ids.begin() + first, ids.begin() + last,
+                    it->second->ids.begin(), it->second->ids.end()
+                )
+            ) {
+                // Mark as most recently used
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                out = it->second->result;
+                ++counters.hits;
+                return true;
+            }
+        }
+
+        ++counters.misses;
+        return false;
+    }
+
+    /// @brief Store the result of parsing ids [first, last) from state
+    void insert(
+        unsigned state, const vector<unsigned>& ids, size_t first, size_t last,
+        uint64_t hash, cached_parse_t result
+    ) {
+        uint64_t k = key(state, hash);
+        shard_t& shard = shard_for(k);
+
+        if (shard.capacity == 0) return;
+
+        lock_guard<mutex> lock(shard.entries_mutex);
+        auto it = shard.index.find(k);
+
+        if (it != shard.index.end()) {
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        } else if (shard.lru.size() >= shard.capacity) {
+            // Evict least recently used entry of this shard
+            shard.index.erase(key(shard.lru.back().state, shard.lru.back().hash));
+            shard.lru.pop_back();
+        }
+
+        shard.lru.push_front({
+            state, hash,
+            vector<unsigned>(ids.begin() + first, ids.begin() + last),
+            std::move(result)
+        });
+        shard.index[k] = shard.lru.begin();
+    }
+
+    cache_stats_t stats() const {
+        size_t entries = 0;
+
+        for (const shard_t& shard : shards) {
+            lock_guard<mutex> lock(shard.entries_mutex);
+            entries += shard.lru.size();
+        }
+
+        return {
+            whole.hits, whole.misses, group.hits, group.misses, entries
+        };
+    }
+
+private:
+    /// @typedef entry_t : cached result along with the key it was stored under
+    struct entry_t {
+        unsigned state;          // Parser state the span was parsed from
+        uint64_t hash;           // Span hash of ids
+        vector<unsigned> ids;    // Terminal ids, to rule out hash collisions
+        cached_parse_t result;   // Result of parsing the span
+    };
+
+    /// @typedef shard_t : independently locked slice of the cache entries
+    struct shard_t {
+        size_t capacity = 0;          // Maximum entries before eviction
+        mutable mutex entries_mutex;  // Guards lru and index
+        list<entry_t> lru;            // Entries, most recently used first
+        unordered_map<uint64_t, list<entry_t>::iterator> index;  // By key
+    };
+
+    /// @typedef counters_t : hit and miss counts for one kind of lookup
+    struct counters_t {
+        atomic<size_t> hits{0};    // Lookups answered from the cache
+        atomic<size_t> misses{0};  // Lookups that had to be parsed
+    };
+
+    static const size_t MAX_SHARDS = 16;  // Shards used by large caches
+
+    static uint64_t key(unsigned state, uint64_t hash) {
+        return hash ^ ((uint64_t)state + 1) * 0x9e3779b97f4a7c15ULL;
+    }
+
+    shard_t& shard_for(uint64_t k) {
+        // High bits, since the low bits of the key feed the shard's own index
+        return shards[(k >> 40) % shards.size()];
+    }
+
+    vector<shard_t> shards;  // Entries, split by key
+    vector<int> closer;      // Closing terminal for each opening terminal, or -1
+
+    counters_t whole;  // Lookups of whole inputs (entry state 0)
+    counters_t group;  // Lookups of bracketed groups inside an input
+};
+
+#endif /* CACHE_H */
+
+/* EOF */
@@ -0,0 +1,176 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/// @brief Pre-scoped identifiers
+
+using std::cout;
+using std::sort;
+using std::string;
+using std::thread;
+using std::vector;
+
+/// @typedef Parse_Client : connection to a Parse_Server listening on a Unix
+///     domain socket which sends one request at a time
+class Parse_Client {
+public:
+    Parse_Client() = default;
+
+    ~Parse_Client() {
+        if (fd != -1) close(fd);
+    }
+
+    Parse_Client(const Parse_Client&) = delete;
+    Parse_Client& operator=(const Parse_Client&) = delete;
+
+    bool connect_to(const string& path) {
+        sockaddr_un addr{};
+
+        if (path.size() >= sizeof(addr.sun_path)) return false;
+
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path.c_str());
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        return fd != -1 && connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0;
+    }
+
+    /// @brief Send one input string and wait for its response line
+    /// @return response line without its trailing '\n', or empty on failure
+    string request(const string& input) {
+        string line = input + '\n';
+        size_t sent = 0;
+
+        while (sent < line.size()) {
+            ssize_t n = send(fd, line.data() + sent, line.size() - sent,
+                             MSG_NOSIGNAL);
+            if (n <= 0) return "";
+            sent += n;
+        }
+
+        size_t end;  // Position of the '\n' ending the response
+
+        while ((end = buffer.find('\n')) == string::npos) {
+            char chunk[4096];
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n <= 0) return "";
+            buffer.append(chunk, n);
+        }
+
+        string response = buffer.substr(0, end);
+        buffer.erase(0, end + 1);
+
+        return response;
+    }
+
+private:
+    int fd = -1;    // Connected socket
+    string buffer;  // Bytes received past the last response line
+};
+
+/// @brief Measure throughput and latency of a Parse_Server
+/// @note Only "OK" replies count towards throughput and latency; "ERR" replies
+///     are reported as rejected and make the bench exit nonzero
+/// @param path : Unix domain socket the server is listening on
+/// @param input : input string sent with every request
+/// @param requests : total number of requests to send
+/// @param clients : number of concurrent connections sharing the requests
+/// @return integer to operating system
+inline int run_bench(
+    const string& path, const string& input, unsigned requests, unsigned clients
+) {
+    using clock = std::chrono::steady_clock;
+
+    if (clients == 0) clients = 1;
+
+    vector<vector<double>> latencies(clients);  // Microseconds per request
+    vector<unsigned> rejects(clients, 0);       // Requests answered with ERR
+    vector<unsigned> failures(clients, 0);      // Requests without a reply
+    vector<thread> pool;
+
+    auto start = clock::now();
+
+    for (unsigned c = 0; c < clients; ++c) {
+        pool.emplace_back([&, c] {
+            Parse_Client client;
+            unsigned share = requests / clients + (c < requests % clients);
+
+            if (!client.connect_to(path)) {
+                failures[c] = share;
+                return;
+            }
+
+            latencies[c].reserve(share);
+
+            for (unsigned i = 0; i < share; ++i) {
+                auto sent = clock::now();
+                string reply = client.request(input);
+
+                if (reply.empty()) {
+                    failures[c] += share - i;
+                    return;
+                }
+
+                if (reply.compare(0, 3, "OK ") != 0) {
+                    ++rejects[c];
+                    continue;
+                }
+
+                latencies[c].push_back(
+                    std::chrono::duration<double, std::micro>(
+                        clock::now() - sent
+                    ).count()
+                );
+            }
+        });
+    }
+
+    for (thread& t : pool) {
+        t.join();
+    }
+
+    double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+    vector<double> all;  // Every latency sample, for percentiles
+    unsigned rejected = 0;
+    unsigned failed = 0;
+
+    for (unsigned c = 0; c < clients; ++c) {
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        rejected += rejects[c];
+        failed += failures[c];
+    }
+
+    if (all.empty()) {
+        cout << "No requests succeeded against '" << path << "' ("
+             << rejected << " rejected, " << failed << " failed).\n";
+        return 1;
+    }
+
+    sort(all.begin(), all.end());
+
+    cout << "Requests:   " << all.size() << " ok, " << rejected
+         << " rejected, " << failed << " failed, " << clients << " clients\n"
+         << "Throughput: " << all.size() / elapsed << " requests/s\n"
+         << "Latency:    p50 " << all[all.size() / 2] << " us, p99 "
+         << all[all.size() * 99 / 100] << " us, max " << all.back()
+         << " us\n";
+
+    return rejected == 0 && failed == 0 ? 0 : 1;
+}
+
+#endif /* CLIENT_H */
+
+/* EOF */
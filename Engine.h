@@ -0,0 +1,302 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Grammar.h"
+#include "Parser.h"
+#include "Token.h"
+
+/// @brief Direct-threaded dispatch needs the GCC/Clang labels-as-values
+///     extension; define LALR_NO_COMPUTED_GOTO to force the switch loop
+
+#if defined(__GNUC__) && !defined(LALR_NO_COMPUTED_GOTO)
+#define LALR_THREADED 1
+#endif
+
+/// @brief Pre-scoped identifiers
+
+using std::cout;
+using std::list;
+using std::ostream;
+using std::string;
+using std::to_string;
+using std::vector;
+
+/// @typedef Threaded_Engine : LALR automaton precompiled from the ACTION and
+///     GOTO tables of a LALR_Parser into one compact dispatch record per state
+/// @note States whose filled cells are all the same reduction reduce without
+///     looking at the input, and other states fall back to their most common
+///     reduction. As with yacc default reductions, an error may therefore be
+///     reported a few reductions later than LALR_Parser::parse reports it, but
+///     never after an erroneous token is shifted.
+class Threaded_Engine {
+public:
+    Threaded_Engine(const LALR_Parser& parser)
+        : num_states((uint32_t)parser.states.size()),
+          halt((int32_t)-(parser.G.num_prods() + 1)) {
+        // Production details needed by a reduction
+        for (size_t p = 0; p < parser.G.num_prods(); ++p) {
+            production_t prod = parser.G.get_production((unsigned)p);
+
+            reductions.push_back({
+                (uint32_t)prod.rhs.size(), prod.lhs.table_idx * num_states
+            });
+            labels.push_back(to_string(p + 1));
+        }
+
+        // Dense GOTO table indexed by lhs offset plus state
+        gotos.assign(parser.G.num_nterms() * num_states, 0);
+
+        for (uint32_t n = 0; n < parser.goto_push.size(); ++n) {
+            for (uint32_t s = 0; s < num_states; ++s) {
+                gotos[n * num_states + s] = parser.goto_push[n].valid_states[s];
+            }
+        }
+
+        // One dispatch record per state, built from that state's ACTION column
+        for (uint32_t s = 0; s < num_states; ++s) {
+            vector<edge_t> cells;  // Filled ACTION cells for this state
+
+            for (uint32_t t = 0; t < parser.actions.size(); ++t) {
+                if (parser.actions[t].actions[s] != 0) {
+                    cells.push_back({t, parser.actions[t].actions[s]});
+                }
+            }
+
+            compile_state(cells);
+        }
+    }
+
+    /// @brief Parse a dense sequence of terminal ids ending with the '\eof' id
+    /// @param ids : terminal id of each input token
+    /// @param log : stream which receives parsing diagnostics
+    /// @return reverse rightmost derivation of the input
+    string run(const vector<uint32_t>& ids, ostream& log = cout) const {
+        string rrd = "";  // Reverse rightmost derivation
+        size_t front;     // Token the parse stopped at
+
+        if (execute(ids, rrd, front) == EMPTY_CELL) {
+            log << "Error. Parser hit an empty cell at token " << front << ".\n";
+        } else if (front == ids.size()) {
+            log << "Error. Ran out of input during parse without halting.\n";
+        }
+
+        return rrd;
+    }
+
+    /// @brief Parse lexer output, reporting errors by line and column
+    string run(const Token_Buffer& tokens, ostream& log = cout) const {
+        string rrd = "";  // Reverse rightmost derivation
+        size_t front;     // Token the parse stopped at
+
+        if (execute(tokens.ids, rrd, front) == EMPTY_CELL) {
+            log << "Error. Parser hit an empty cell at "
+                << tokens.describe(tokens.offsets[front]) << ".\n";
+        } else if (front == tokens.size()) {
+            log << "Error. Ran out of input during parse without halting.\n";
+        }
+
+        return rrd;
+    }
+
+    /// @brief Parse a lexicated input string
+    string run(const list<Token>& input, ostream& log = cout) const {
+        vector<uint32_t> ids;  // Terminal id of each input token
+
+        ids.reserve(input.size());
+
+        for (const Token& token : input) {
+            ids.push_back(token.table_idx);
+        }
+
+        return run(ids, log);
+    }
+
+private:
+    /// @brief How a run of the automaton ended
+    enum outcome_t {
+        HALTED,      // Input accepted, or ran out before halting
+        EMPTY_CELL   // Input rejected at the front token
+    };
+
+    /// @brief Run the automaton over ids, appending to rrd
+    /// @param front : set to the position of the token the run stopped at
+    outcome_t execute(
+        const vector<uint32_t>& ids, string& rrd, size_t& front
+    ) const {
+        vector<uint32_t> stack;  // State stack, starting with only EOF state
+        const dispatch_t* state; // Record for the state on top of the stack
+        int32_t action = 0;      // Action chosen by a lookup state
+
+        front = 0;
+        stack.reserve(64);
+        stack.push_back(0);
+
+#ifdef LALR_THREADED
+        static void* const HANDLERS[] = {
+            &&target_REDUCE_STATE, &&target_SHIFT_STATE, &&target_MIXED_STATE
+        };
+
+#define TARGET(kind) case kind: target_##kind
+#define DISPATCH()                                                            \
+    do {                                                                      \
+        state = &table[stack.back()];                                         \
+        goto *HANDLERS[state->kind];                                          \
+    } while (0)
+#else
+#define TARGET(kind) case kind
+#define DISPATCH() continue
+#endif
+
+        for (;;) {
+            state = &table[stack.back()];
+
+            switch (state->kind) {
+            TARGET(REDUCE_STATE): {
+                action = state->fallback;
+                goto reduce;
+            }
+
+            TARGET(SHIFT_STATE):
+            TARGET(MIXED_STATE): {
+                if (front == ids.size()) goto done;
+
+                action = find_action(*state, ids[front]);
+
+                if (action > 0) {  // Shift
+                    stack.push_back((uint32_t)action);
+                    ++front;
+                    DISPATCH();
+                }
+
+                if (action == halt) goto done;
+                if (action == 0) goto error;
+                goto reduce;
+            }
+            }
+
+        reduce: {
+                const reduction_t& r = reductions[-action - 1];
+
+                stack.resize(stack.size() - r.rhs_len);
+                stack.push_back(gotos[r.goto_row + stack.back()]);
+                rrd += labels[-action - 1];
+                DISPATCH();
+            }
+        }
+
+#undef TARGET
+#undef DISPATCH
+
+    error:
+        return EMPTY_CELL;
+
+    done:
+        return HALTED;
+    }
+
+    /// @brief Handler run for a state's dispatch record
+    enum kind_t : uint8_t {
+        REDUCE_STATE,  // Every filled cell is the same reduction
+        SHIFT_STATE,   // Look up the input; an unlisted id is an error
+        MIXED_STATE    // Look up the input; an unlisted id takes the fallback
+    };
+
+    /// @typedef edge_t : filled ACTION cell kept for a lookup state
+    struct edge_t {
+        uint32_t term;   // Terminal id of the input token
+        int32_t action;  // Shift target, reduction or halt, as in parser.txt
+    };
+
+    /// @typedef dispatch_t : compact per-state record driving the dispatch
+    struct dispatch_t {
+        kind_t kind;       // Handler for this state
+        uint32_t first;    // First edge of this state in edges
+        uint32_t last;     // One past the last edge of this state in edges
+        int32_t fallback;  // Default reduction (negative), or 0 for none
+    };
+
+    /// @typedef reduction_t : what a reduction pops and where its GOTO row is
+    struct reduction_t {
+        uint32_t rhs_len;   // Symbols popped by the production
+        uint32_t goto_row;  // Offset of the lhs row in gotos
+    };
+
+    void compile_state(vector<edge_t>& cells) {
+        // Pick the most common reduction as this state's default
+        int32_t fallback = 0;
+        size_t best = 0;
+
+        for (const edge_t& cell : cells) {
+            if (cell.action >= 0 || cell.action == halt) continue;
+
+            size_t count = 0;
+
+            for (const edge_t& other : cells) {
+                count += other.action == cell.action;
+            }
+
+            if (count > best) {
+                best = count;
+                fallback = cell.action;
+            }
+        }
+
+        dispatch_t record;
+
+        record.first = (uint32_t)edges.size();
+        record.fallback = fallback;
+
+        // Shifts first, since they are the common case in a lookup state
+        std::stable_sort(cells.begin(), cells.end(),
+            [](const edge_t& a, const edge_t& b) {
+                return (a.action > 0) > (b.action > 0);
+            });
+
+        for (const edge_t& cell : cells) {
+            if (cell.action != fallback) edges.push_back(cell);
+        }
+
+        record.last = (uint32_t)edges.size();
+
+        if (fallback == 0) {
+            record.kind = SHIFT_STATE;
+        } else if (record.first == record.last) {
+            record.kind = REDUCE_STATE;
+        } else {
+            record.kind = MIXED_STATE;
+        }
+
+        table.push_back(record);
+    }
+
+    int32_t find_action(const dispatch_t& state, uint32_t term) const {
+        for (uint32_t e = state.first; e != state.last; ++e) {
+            if (edges[e].term == term) return edges[e].action;
+        }
+
+        return state.fallback;
+    }
+
+    // Automaton details
+    uint32_t num_states;  // Number of states in the automaton
+    int32_t halt;         // Halt action, as in parser.txt
+
+    // Compiled tables
+    vector<dispatch_t> table;        // Dispatch record for each state
+    vector<edge_t> edges;            // Listed cells of every lookup state
+    vector<uint32_t> gotos;          // GOTO table, lhs-major
+    vector<reduction_t> reductions;  // Reduction details for each production
+    vector<string> labels;           // Production numbers for the derivation
+};
+
+#endif /* ENGINE_H */
+
+/* EOF */
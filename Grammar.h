@@ -1,9 +1,11 @@
 #ifndef GRAMMAR_H
 #define GRAMMAR_H
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <list>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -91,6 +93,46 @@ public:
         return result;
     }
 
+    /// @brief Count the terminal tokens whose ident starts with prefix,
+    ///     stopping at 2, without building a list of them
+    /// @param only : set to the matching token when exactly one matches
+    size_t count_prefix_matches(const string& prefix, const Token*& only) const {
+        auto it = std::lower_bound(
+            by_ident.begin(), by_ident.end(), prefix,
+            [this](unsigned idx, const string& p) {
+                return terminals[idx].ident < p;
+            }
+        );
+        size_t count = 0;
+
+        while (
+            it != by_ident.end() && count < 2 &&
+            terminals[*it].ident.compare(0, prefix.size(), prefix) == 0
+        ) {
+            only = &terminals[*it];
+            ++count;
+            ++it;
+        }
+
+        return count;
+    }
+
+    const Token& get_terminal(unsigned which) const {
+        if (which >= terminals.size()) {
+            throw std::out_of_range("Terminal index exceeds terminal list");
+        }
+
+        return terminals[which];
+    }
+
+    const Token& get_nonterminal(unsigned which) const {
+        if (which >= nonterminals.size()) {
+            throw std::out_of_range("Nonterminal index exceeds nonterminal list");
+        }
+
+        return nonterminals[which];
+    }
+
     /// @brief Mutator Methods
 
     void read(ifstream& infile) {
@@ -165,6 +207,17 @@ public:
             terminals.push_back(input);          // Add to terminal list
         }
 
+        // Index terminals by ident for prefix matching while lexicating
+        by_ident.clear();
+
+        for (unsigned k = 0; k < terminals.size(); ++k) {
+            by_ident.push_back(k);
+        }
+
+        std::sort(by_ident.begin(), by_ident.end(), [this](unsigned a, unsigned b) {
+            return terminals[a].ident < terminals[b].ident;
+        });
+
         // Read list of grammar productions
         infile.ignore(100, '\n');  // Grammar productions comment
 
@@ -282,6 +335,7 @@ private:
     // Grammar Details
     vector<Token> nonterminals;  // Nonterminal token instances in the grammar
     vector<Token> terminals;     // Terminal token instances in the grammar
+    vector<unsigned> by_ident;   // Terminal indices sorted by ident
     Token start;                 // Nonterminal starting token for the grammar
     vector<production_t> prods;  // Productions that derive valid token strings
 };
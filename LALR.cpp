@@ -1,21 +1,31 @@
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <iterator>
 #include <iostream>
 #include <list>
+#include <sstream>
 #include <string>
 
+#include "Client.h"
+#include "Engine.h"
+#include "Lexer.h"
 #include "Parser.h"
+#include "Server.h"
 
 /// @brief Pre-scoped identifiers
 
 using std::cout;
 using std::ifstream;
 using std::list;
+using std::ostringstream;
 using std::reverse;
+using std::stoul;
 using std::string;
 
 /// @brief Function declarations
 
-list<Token> lexicate(const string& input, const Grammar& g);
+bool all_counts(int argc, char** argv, int first);
 
 /// @brief Main function
 /// @param argc : number of command-line arguments on program execution
@@ -23,8 +33,38 @@ list<Token> lexicate(const string& input, const Grammar& g);
 /// @return integer to operating system
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        cout << "Usage: " << argv[0] << " [input string]\n";
+    string mode = argc > 1 ? argv[1] : "";
+
+    // Benchmark a running server; needs no grammar of its own
+    if (mode == "--bench") {
+        if (argc < 4 || argc > 6 || !all_counts(argc, argv, 4)) {
+            cout << "Usage: " << argv[0] << " --bench [socket] [input string]"
+                 << " [requests (10000)] [clients (4)]\n";
+            return 0;
+        }
+
+        return run_bench(
+            argv[2], argv[3],
+            argc > 4 ? (unsigned)stoul(argv[4]) : 10000,
+            argc > 5 ? (unsigned)stoul(argv[5]) : 4
+        );
+    }
+
+    bool known_form = argc == 2 ||
+        (mode == "--serve" && argc <= 5) ||
+        (mode == "--check" && (argc == 3 || argc == 4)) ||
+        (mode == "--bench-engine" && (argc == 3 || argc == 4));
+
+    // Every mode taking more arguments expects counts from the third on
+    if (!known_form || (argc > 2 && !all_counts(argc, argv, 3))) {
+        cout << "Usage: " << argv[0] << " [input string]\n"
+             << "       " << argv[0] << " --serve [socket|-] [workers]"
+             << " [cache entries]\n"
+             << "       " << argv[0] << " --check [file] [recovery budget]\n"
+             << "       " << argv[0] << " --bench-engine [input string]"
+             << " [iterations]\n"
+             << "       " << argv[0] << " --bench [socket] [input string]"
+             << " [requests] [clients]\n";
         return 0;
     }
 
@@ -40,9 +80,102 @@ int main(int argc, char** argv) {
     // Populate parser from file
     parser.read(parser_file);
 
+    // Serve requests from stdin, or from a socket if one is given
+    if (mode == "--serve") {
+        string socket_path = argc > 2 ? argv[2] : "-";
+        Parse_Server server(
+            g, parser,
+            argc > 3 ? (unsigned)stoul(argv[3]) : 0,
+            argc > 4 ? stoul(argv[4]) : 0
+        );
+
+        return server.run(socket_path == "-" ? "" : socket_path);
+    }
+
+    // Report every error in a file in one pass
+    if (mode == "--check") {
+        ifstream check_file(argv[2]);
+
+        if (!check_file) {
+            cout << "Unable to open '" << argv[2] << "'.\n";
+            return 1;
+        }
+
+        string text(
+            (std::istreambuf_iterator<char>(check_file)),
+            std::istreambuf_iterator<char>()
+        );
+        ostringstream log;  // Diagnostics from the lexer and parser
+
+        parser.set_recovery(argc > 3 ? (unsigned)stoul(argv[3]) : 64);
+        Token_Buffer tokens;  // Lexer output with source positions
+
+        lexicate(text, g, tokens, log, true);
+        parser.parse(tokens, log);
+
+        cout << (log.str().empty() ? "No errors found.\n" : log.str());
+
+        return log.str().empty() ? 0 : 1;
+    }
+
+    // Time the list lexer and table-driven loop against the token buffer
+    // and threaded engine
+    if (mode == "--bench-engine") {
+        using clock = std::chrono::steady_clock;
+        using nanoseconds = std::chrono::duration<double, std::nano>;
+
+        string input = argv[2];
+        list<Token> tokens;   // List lexer output
+        Token_Buffer buffer;  // Parallel array lexer output, reused
+        Threaded_Engine engine(parser);
+        unsigned iterations = argc > 3 ? (unsigned)stoul(argv[3]) : 100000;
+        string table_rrd, engine_rrd;
+
+        auto t0 = clock::now();
+
+        for (unsigned i = 0; i < iterations; ++i) {
+            tokens = lexicate(input, g);
+        }
+
+        auto t1 = clock::now();
+
+        for (unsigned i = 0; i < iterations; ++i) {
+            lexicate(input, g, buffer);
+        }
+
+        auto t2 = clock::now();
+
+        for (unsigned i = 0; i < iterations; ++i) {
+            table_rrd = parser.parse(buffer);
+        }
+
+        auto t3 = clock::now();
+
+        for (unsigned i = 0; i < iterations; ++i) {
+            engine_rrd = engine.run(buffer);
+        }
+
+        auto t4 = clock::now();
+
+        cout << "Tokens:          " << tokens.size() << '\n'
+             << "Lex to list:     " << nanoseconds(t1 - t0).count() / iterations
+             << " ns/input\n"
+             << "Lex to buffer:   " << nanoseconds(t2 - t1).count() / iterations
+             << " ns/input\n"
+             << "Table-driven:    " << nanoseconds(t3 - t2).count() / iterations
+             << " ns/parse\n"
+             << "Threaded:        " << nanoseconds(t4 - t3).count() / iterations
+             << " ns/parse\n"
+             << "Same derivation: " << (table_rrd == engine_rrd ? "yes" : "no")
+             << '\n';
+
+        return table_rrd == engine_rrd ? 0 : 1;
+    }
+
     // Test LALR parser
     string input = argv[1];
-    list<Token> tokens = lexicate(input, g);
+    Token_Buffer tokens;
+    lexicate(input, g, tokens);
 
     string rrd = parser.parse(tokens);
     string  rd = rrd;
@@ -57,73 +190,18 @@ int main(int argc, char** argv) {
 
 /// @brief Function definitions
 
-list<Token> lexicate(const string& input, const Grammar& g) {
-    list<Token> tokens;
-    string poss_ident = "";  // Possible identifier string to search for
-
-    auto it = input.begin();
-
-    while (it != input.end()) {
-        if (isspace(*it) == 0) {  // Not a space character
-            poss_ident += *it;
-            list<Token> poss_tokens = g.term_prefix_matches(poss_ident);
-
-            // No tokens to pick from that have this prefix in their ident
-            if (poss_tokens.empty()) {
-                cout << "Unknown symbol '" << poss_ident
-                     << "' found during lexicating.\n";
-                return {};
-            // Found exactly one token that matches this ident
-            } else if (
-                poss_tokens.size() == 1 &&
-                poss_tokens.front().ident == poss_ident
-            ) {
-                tokens.push_back(poss_tokens.front());
-                poss_ident = "";
-            // Else continue adding characters
-            }
-        } else {  // Is a space character
-            if (!poss_ident.empty()) {
-                list<Token> poss_tokens = g.term_prefix_matches(poss_ident);
-
-                // One token terminated by a space matches this prefix
-                if (
-                    poss_tokens.size() == 1 &&
-                    poss_tokens.front().ident == poss_ident
-                ) {
-                    tokens.push_back(poss_tokens.front());
-                    poss_ident = "";
-                // Not exactly one token to pick from
-                } else {
-                    cout << "Unknown symbol '" << poss_ident
-                        << "' found during lexicating.\n";
-                    return {};
-                }
-            }
-        }
+/// @brief Check that every argument from first on is an unsigned count
+bool all_counts(int argc, char** argv, int first) {
+    for (int i = first; i < argc; ++i) {
+        string text = argv[i];
 
-        ++it;
-    }
-
-    if (!poss_ident.empty()) {
-        list<Token> poss_tokens = g.term_prefix_matches(poss_ident);
-
-        // One token terminated by EOF matches this prefix
         if (
-            poss_tokens.size() == 1 &&
-            poss_tokens.front().ident == poss_ident
+            text.empty() || text.size() > 9 ||
+            text.find_first_not_of("0123456789") != string::npos
         ) {
-            tokens.push_back(poss_tokens.front());
-            poss_ident = "";
-        // Not exactly one token to pick from
-        } else {
-            cout << "Unknown symbol '" << poss_ident
-                << "' found during lexicating.\n";
-            return {};
+            return false;
         }
     }
 
-    tokens.push_back({"\\eof", true, (unsigned)g.num_terms()});
-
-    return tokens;
+    return true;
 }
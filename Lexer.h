@@ -0,0 +1,167 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <cctype>
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <ostream>
+#include <string>
+
+#include "Token.h"
+#include "Grammar.h"
+
+/// @brief Pre-scoped identifiers
+
+using std::cout;
+using std::list;
+using std::ostream;
+using std::string;
+using std::to_string;
+
+/// @brief Match the terminal tokens of a grammar in an input string
+/// @param emit : called with each matched token, its byte offset and length
+/// @param where : names a byte offset for diagnostics
+/// @return whether lexicating reached the end of the input
+
+template <typename Emit, typename Where>
+bool lex_terminals(
+    const string& input, const Grammar& g, ostream& log, bool recover,
+    Emit emit, Where where
+) {
+    string poss_ident = "";  // Possible identifier string to search for
+    size_t ident_at = 0;     // Byte offset of poss_ident in the input
+    const Token* match = nullptr;  // Only terminal with poss_ident as prefix
+    size_t matches;                // Terminals with poss_ident as prefix (<= 2)
+
+    auto it = input.begin();
+
+    while (it != input.end()) {
+        if (isspace(*it) == 0) {  // Not a space character
+            if (poss_ident.empty()) ident_at = it - input.begin();
+
+            poss_ident += *it;
+            matches = g.count_prefix_matches(poss_ident, match);
+
+            // No tokens to pick from that have this prefix in their ident
+            if (matches == 0) {
+                log << "Unknown symbol '" << poss_ident
+                     << "' found during lexicating at " << where(ident_at)
+                     << ".\n";
+                if (!recover) return false;
+                poss_ident = "";
+            // Found exactly one token that matches this ident
+            } else if (
+                matches == 1 && match->ident == poss_ident
+            ) {
+                emit(*match, ident_at, poss_ident.size());
+                poss_ident = "";
+            // Else continue adding characters
+            }
+        } else {  // Is a space character
+            if (!poss_ident.empty()) {
+                matches = g.count_prefix_matches(poss_ident, match);
+
+                // One token terminated by a space matches this prefix
+                if (
+                    matches == 1 && match->ident == poss_ident
+                ) {
+                    emit(*match, ident_at, poss_ident.size());
+                    poss_ident = "";
+                // Not exactly one token to pick from
+                } else {
+                    log << "Unknown symbol '" << poss_ident
+                        << "' found during lexicating at " << where(ident_at)
+                        << ".\n";
+                    if (!recover) return false;
+                    poss_ident = "";
+                }
+            }
+        }
+
+        ++it;
+    }
+
+    if (!poss_ident.empty()) {
+        matches = g.count_prefix_matches(poss_ident, match);
+
+        // One token terminated by EOF matches this prefix
+        if (
+            matches == 1 && match->ident == poss_ident
+        ) {
+            emit(*match, ident_at, poss_ident.size());
+            poss_ident = "";
+        // Not exactly one token to pick from
+        } else {
+            log << "Unknown symbol '" << poss_ident
+                << "' found during lexicating at " << where(ident_at) << ".\n";
+            if (!recover) return false;
+        }
+    }
+
+    return true;
+}
+
+/// @brief Split an input string into the terminal tokens of a grammar
+/// @param input : physical string to be lexicated
+/// @param g : grammar whose terminal tokens are matched against the input
+/// @param log : stream which receives lexing diagnostics
+/// @param recover : drop unknown symbols and keep lexicating instead of
+///     stopping at the first one
+/// @return list of terminal tokens followed by '\eof', or empty on error
+
+inline list<Token> lexicate(
+    const string& input, const Grammar& g, ostream& log = cout,
+    bool recover = false
+) {
+    list<Token> tokens;
+
+    bool lexed = lex_terminals(
+        input, g, log, recover,
+        [&](const Token& token, size_t offset, size_t) {
+            tokens.push_back(token);
+            tokens.back().offset = offset;
+        },
+        [](size_t offset) { return "offset " + to_string(offset); }
+    );
+
+    if (!lexed) return {};
+
+    tokens.push_back({"\\eof", true, (unsigned)g.num_terms(), input.size()});
+
+    return tokens;
+}
+
+/// @brief Split an input string into parallel terminal id, offset and length
+///     arrays, reusing the capacity the buffer already has
+/// @param out : buffer which is cleared and then filled, ending with '\eof'
+/// @return whether lexicating succeeded; out is left empty on error
+
+inline bool lexicate(
+    const string& input, const Grammar& g, Token_Buffer& out,
+    ostream& log = cout, bool recover = false
+) {
+    out.clear();
+    out.index_lines(input);
+
+    bool lexed = lex_terminals(
+        input, g, log, recover,
+        [&](const Token& token, size_t offset, size_t length) {
+            out.push_back(token.table_idx, offset, length);
+        },
+        [&](size_t offset) { return out.describe(offset); }
+    );
+
+    if (!lexed) {
+        out.clear();
+        return false;
+    }
+
+    out.push_back((uint32_t)g.num_terms(), input.size(), 0);
+
+    return true;
+}
+
+#endif /* LEXER_H */
+
+/* EOF */
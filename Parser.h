@@ -1,12 +1,16 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <list>
+#include <ostream>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
+#include "Cache.h"
 #include "Token.h"
 #include "Grammar.h"
 
@@ -14,13 +18,16 @@
 
 using std::cout;
 using std::ifstream;
+using std::list;
+using std::ostream;
 using std::string;
 using std::to_string;
-using std::unordered_map;
 using std::vector;
 
 /// @typedef action_t : handle to represent actions taken given an input to a
 ///     LALR parser and the current stack state of the parser
+/// @note ACTION rows are indexed by terminal id, with '\eof' last, and GOTO
+///     rows by nonterminal id, so parsing never hashes a token
 struct action_t {
     vector<int> actions;  // Actions to execute when parsing an input token
 };
@@ -35,6 +42,8 @@ struct goto_t {
 ///     grammar with the grammar itself
 /// @note This parser is implemented as a LALR parser
 class LALR_Parser {
+    friend class Threaded_Engine;  // Compiles the ACTION/GOTO tables
+
 public:
     LALR_Parser(const Grammar& g) : G(g) {}
 
@@ -72,12 +81,21 @@ public:
         }
 
 
+        // Lhs and rhs length of each production, needed by a reduction
+        for (size_t p = 0; p < G.num_prods(); ++p) {
+            production_t prod = G.get_production((unsigned)p);
+            rules.push_back({prod.lhs.table_idx, prod.rhs.size()});
+        }
+
         // Read action table
         infile.ignore(100, '\n');  // Action table comment
         line = 1;  // Reset line to 1 for action table reading
 
         size_t num_prods = G.num_prods();  // Number of productions in grammar
 
+        // Terminals without an ACTION line have only empty cells
+        actions.assign(G.num_terms() + 1, {vector<int>(states.size(), 0)});
+
         while (infile.peek() != '#') {
             // Read leading terminal token
             infile >> input;
@@ -97,6 +115,12 @@ public:
                 return;
             }
 
+            if (!it->terminal) {
+                cout << "ACTION line " << line << " starts with nonterminal '"
+                     << input << "'\n";
+                return;
+            }
+
             action_t entries;
             int action;
             size_t i = 0;
@@ -131,8 +155,8 @@ public:
                 return;
             }
 
-            // Add action list entry to map
-            actions[*it] = entries;
+            // Add action list entry to its terminal's row
+            actions[it->table_idx] = entries;
 
             // Move on to next action line
             ++line;
@@ -143,6 +167,9 @@ public:
         infile.ignore(100, '\n');  // Goto table comment
         line = 1;
 
+        // Nonterminals without a GOTO line push the EOF state
+        goto_push.assign(G.num_nterms(), {vector<unsigned>(states.size(), 0)});
+
         while (infile.peek() != '#') {
             // Read leading terminal token
             infile >> input;
@@ -182,8 +209,8 @@ public:
                 return;
             }
 
-            // Add goto list entry to map
-            goto_push[{input, false, (unsigned)index}] = entries;
+            // Add goto list entry to its nonterminal's row
+            goto_push[index] = entries;
 
             // Move on to next goto line
             ++line;
@@ -206,10 +233,10 @@ public:
 
         cout << "Action Table:\n";
 
-        for (auto& [token, action] : actions) {
-            cout << "  " << token.ident << ' ';
+        for (size_t t = 0; t < actions.size(); ++t) {
+            cout << "  " << symbol((unsigned)t) << ' ';
 
-            for (int act : action.actions) {
+            for (int act : actions[t].actions) {
                 cout << act << ' ';
             }
             cout << '\n';
@@ -217,77 +244,408 @@ public:
 
         cout << "Goto Table:\n";
 
-        for (auto& [token, state] : goto_push) {
-            cout << "  " << token.ident << ' ';
+        for (size_t n = 0; n < goto_push.size(); ++n) {
+            cout << "  " << G.get_nonterminal((unsigned)n).ident << ' ';
 
-            for (int st : state.valid_states) {
+            for (int st : goto_push[n].valid_states) {
                 cout << st << ' ';
             }
             cout << '\n';
         }
     }
 
-    string parse(const list<Token>& input) {
+    /// @brief Parse a lexicated input string
+    /// @param input : terminal tokens followed by '\eof'
+    /// @param log : stream which receives parsing diagnostics
+    /// @param cache : optional cache of whole inputs and bracketed groups
+    /// @return reverse rightmost derivation of the input
+    string parse(
+        const list<Token>& input, ostream& log = cout,
+        Parse_Cache* cache = nullptr
+    ) const {
+        vector<uint32_t> ids;      // Terminal id of each input token
+        vector<uint32_t> offsets;  // Byte offset of each input token
+
+        ids.reserve(input.size());
+        offsets.reserve(input.size());
+
+        for (const Token& token : input) {
+            ids.push_back(token.table_idx);
+            offsets.push_back((uint32_t)token.offset);
+        }
+
+        return parse_ids(ids, offsets, log, cache, [](size_t offset) {
+            return "offset " + to_string(offset);
+        });
+    }
+
+    /// @brief Parse lexer output kept in a Token_Buffer, reporting errors by
+    ///     line and column
+    string parse(
+        const Token_Buffer& input, ostream& log = cout,
+        Parse_Cache* cache = nullptr
+    ) const {
+        return parse_ids(
+            input.ids, input.offsets, log, cache,
+            [&input](size_t offset) { return input.describe(offset); }
+        );
+    }
+
+    /// @brief Keep parsing after an error, resynchronizing on the ACTION table
+    /// @param budget : maximum number of stack/input configurations tried per
+    ///     error before falling back to skipping tokens, or 0 to stop at the
+    ///     first error
+    void set_recovery(unsigned budget) {
+        recovery = budget;
+    }
+
+private:
+    /// @brief Parse terminal ids, naming byte offsets in diagnostics with where
+    /// @param ids : terminal id of each input token, ending with '\eof'
+    /// @param offsets : byte offset of each input token
+    template <typename Where>
+    string parse_ids(
+        const vector<uint32_t>& ids, const vector<uint32_t>& offsets,
+        ostream& log, Parse_Cache* cache, Where where
+    ) const {
         const int HALT = (int)-(G.num_prods() + 1);  // Halt in action table
         bool running = true;                    // Still parsing
-        auto front = input.begin();             // Front of input token list
+        size_t pos = 0;                         // Position of the front token
         string rrd = "";                        // Reverse rightmost derivation
+        string errors = "";                     // Diagnostics for this input
+        vector<unsigned> parse_stack = {0};     // Stack with only EOF state
+
+        // Cache details
+        Span_Hasher hasher;        // Hashes of spans of ids
+        vector<int> match;         // Position of each opener's closing token
+        vector<group_t> groups;    // Bracketed groups whose parse is recorded
 
-        parse_stack = {0};  // Set stack to contain only EOF state
+        if (cache != nullptr) {
+            hasher.build(ids);
+
+            cached_parse_t hit;
+
+            if (cache->find(0, ids, 0, ids.size(), hasher.span(0, ids.size()), hit)) {
+                return hit.rrd;
+            }
+
+            match = cache->match_groups(ids);
+        }
 
-        while (running && front != input.end()) {
-            unsigned& top = parse_stack.back();  // Top of state stack
-            const Token& first = *front;         // Front of input
-            const int& action = actions[first].actions.at(top);
+        size_t resumed_at = ids.size();  // Position after the last recovery
+        size_t shifted = CONFIRM;        // Tokens shifted since the last report
+        size_t hidden = 0;               // Errors not reported since then
+        size_t hidden_from = 0;          // Byte offset of the first of them
+        size_t hidden_to = 0;            // Byte offset of the last of them
+
+        // Summarize the errors hidden after the last reported one
+        auto report_hidden = [&]() {
+            if (hidden == 0) return;
+
+            errors += "Error. Not reporting " + to_string(hidden)
+                    + (hidden == 1 ? " more error at " : " more errors from ")
+                    + where(hidden_from)
+                    + (hidden == 1 ? "" : " to " + where(hidden_to))
+                    + " right after it.\n";
+            hidden = 0;
+        };
+
+        while (running && pos < ids.size()) {
+            unsigned top = parse_stack.back();  // Top of state stack
+            const unsigned first = ids[pos];    // Front of input
+            const int action = action_for(first, top);
 
             if (action > 0) {  // Shift first token onto top of stack
                 parse_stack.push_back(action);
-                ++front;
+
+                if (cache != nullptr && !groups.empty() &&
+                    groups.back().close == pos) {
+                    finish_group(*cache, ids, hasher, rrd, parse_stack, groups);
+                }
+
+                if (cache != nullptr && match.at(pos) != -1) {
+                    size_t close = (size_t)match[pos];
+                    cached_parse_t hit;
+
+                    // Replay a known group, or record it for next time
+                    if (cache->find(action, ids, pos + 1, close + 1,
+                                    hasher.span(pos + 1, close + 1), hit)) {
+                        rrd += hit.rrd;
+                        parse_stack.insert(
+                            parse_stack.end(), hit.stack.begin(), hit.stack.end()
+                        );
+                        shifted += close + 1 - pos;
+                        pos = close + 1;
+                        continue;
+                    }
+
+                    groups.push_back({
+                        (unsigned)action, pos, close, parse_stack.size(),
+                        rrd.size(), true
+                    });
+                }
+
+                ++pos;
+                ++shifted;
             } else if (action == HALT) {  // Done parsing; terminate
                 running = false;
             } else if (action < 0) {  // Reduce top of stack and push state
-                production_t prod = G.get_production((unsigned)-action - 1);
-                const Token& lhs_symbol  = prod.lhs;
-                const size_t RHS_SYMBOLS = prod.rhs.size();
+                size_t lowest = reduce(parse_stack, action);
 
-                // Pop symbols from stack for each symbol in rhs of production
-                for (size_t i = 0; i < RHS_SYMBOLS; ++i) {
-                    parse_stack.pop_back();
+                // A group that pops its opener depends on the outer context
+                for (group_t& group : groups) {
+                    if (lowest < group.height) group.valid = false;
                 }
 
-                // Push new symbol from goto table onto stack using production
-                parse_stack.push_back(
-                    goto_push[lhs_symbol]
-                    .valid_states
-                    .at(
-                        parse_stack.back()
-                    )
-                );
-
                 // Store production into reverse rightmost derivation string
                 rrd += to_string(-action);
             } else {
-                cout << "Error. Parser hit an empty cell while parsing.\n";
-                return rrd;
+                // Like yacc, stay silent until CONFIRM tokens have shifted
+                // since the last reported error; hidden errors do not restart
+                // the window, so a cascade is cut at most once
+                if (shifted >= CONFIRM) {
+                    report_hidden();
+                    errors += "Error. Parser hit an empty cell on "
+                            + describe(first) + " at "
+                            + where(offsets[pos]) + "; expected "
+                            + expected(top) + ".\n";
+                    shifted = 0;
+                } else {
+                    if (hidden++ == 0) hidden_from = offsets[pos];
+                    hidden_to = offsets[pos];
+                }
+
+                // Every open group contains this error, so none can be stored
+                groups.clear();
+
+                // Back-to-back errors must skip input to guarantee progress
+                if (recovery == 0) {
+                    running = false;
+                    pos = ids.size();
+                } else if (recover(parse_stack, ids, pos, pos == resumed_at)) {
+                    resumed_at = pos;
+                } else {
+                    report_hidden();
+                    errors += "Error. No way to continue parsing after the "
+                              "error.\n";
+                    running = false;
+                    pos = ids.size();
+                }
             }
         }
 
+        report_hidden();
+
         if (running) {
-            cout << "Error. Ran out of input during parse without halting.\n";
+            errors += "Error. Ran out of input during parse without halting.\n";
         }
 
+        // Diagnostics name source positions, which differ between inputs
+        // with the same terminals, so only clean parses are stored
+        if (cache != nullptr && errors.empty()) {
+            cache->insert(
+                0, ids, 0, ids.size(), hasher.span(0, ids.size()), {rrd, {}}
+            );
+        }
+
+        log << errors;
+
         return rrd;
     }
 
-private:
+    /// @typedef group_t : bracketed group whose parse is being recorded
+    struct group_t {
+        unsigned state;  // State reached by shifting the opening token
+        size_t open;     // Position of the opening token
+        size_t close;    // Position of the matching closing token
+        size_t height;   // Stack size just after shifting the opening token
+        size_t rrd_at;   // Length of the derivation when the group began
+        bool valid;      // Whether the opening state stayed on the stack
+    };
+
+    /// @typedef rule_t : what a reduction by a production pops and pushes
+    struct rule_t {
+        unsigned lhs;    // Nonterminal id of the production's lhs
+        size_t rhs_len;  // Symbols popped by the production
+    };
+
+    /// @brief Look up ACTION[state, terminal], or 0 for an empty cell
+    int action_for(unsigned term, unsigned state) const {
+        return actions[term].actions[state];
+    }
+
+    /// @brief Ident of a terminal id, with '\eof' for the end of input
+    string symbol(unsigned term) const {
+        return term < G.num_terms() ? G.get_terminal(term).ident : "\\eof";
+    }
+
+    /// @brief Name a terminal id the way diagnostics present it
+    string describe(unsigned term) const {
+        return term < G.num_terms() ? "'" + symbol(term) + "'" : "end of input";
+    }
+
+    /// @brief List the terminal tokens with an action in a state
+    string expected(unsigned state) const {
+        vector<unsigned> valid;  // Terminal ids with a non-empty cell
+
+        for (unsigned t = 0; t < actions.size(); ++t) {
+            if (actions[t].actions.at(state) != 0) valid.push_back(t);
+        }
+
+        if (valid.empty()) return "nothing";
+
+        string result = describe(valid.front());
+
+        for (size_t i = 1; i < valid.size(); ++i) {
+            result += (i + 1 == valid.size() ? " or " : ", ")
+                    + describe(valid[i]);
+        }
+
+        return result;
+    }
+
+    /// @brief Pop the rhs of a production and push the GOTO state for its lhs
+    /// @param action : reduce action, as in the ACTION table
+    /// @return stack size after popping, before the push
+    size_t reduce(vector<unsigned>& stack, int action) const {
+        const rule_t& rule = rules[-action - 1];
+
+        // Pop symbols from stack for each symbol in rhs of production
+        stack.resize(stack.size() - rule.rhs_len);
+
+        size_t lowest = stack.size();
+
+        // Push new symbol from goto table onto stack using production
+        stack.push_back(goto_push[rule.lhs].valid_states.at(stack.back()));
+
+        return lowest;
+    }
+
+    /// @brief Check that a recovery candidate shifts (or halts on) the token
+    ///     it resumes on, rather than reducing into another empty cell
+    /// @param base : index of the candidate's top state in stack
+    /// @param overlay : scratch space for the states reductions push above
+    ///     base, so the stack below is read in place and never copied
+    bool resumes(
+        const vector<unsigned>& stack, size_t base, vector<unsigned>& overlay,
+        unsigned term
+    ) const {
+        const int HALT = (int)-(G.num_prods() + 1);  // Halt in action table
+
+        overlay.clear();
+
+        for (;;) {
+            unsigned top = overlay.empty() ? stack[base] : overlay.back();
+            const int action = action_for(term, top);
+
+            if (action == 0) return false;
+            if (action > 0 || action == HALT) return true;
+
+            // Pop from the overlay first, then from the stack below it
+            const rule_t& rule = rules[-action - 1];
+            size_t popped = std::min(rule.rhs_len, overlay.size());
+
+            overlay.resize(overlay.size() - popped);
+            base -= rule.rhs_len - popped;
+
+            unsigned below = overlay.empty() ? stack[base] : overlay.back();
+            overlay.push_back(goto_push[rule.lhs].valid_states.at(below));
+        }
+    }
+
+    /// @brief Resynchronize after an empty cell by popping states and skipping
+    ///     input tokens, trying the fewest combined edits first. Once the
+    ///     budget is spent, fall back to skipping the front token, or at
+    ///     '\eof' to popping until the front token has a filled cell.
+    ///     Each candidate costs the same however deep the stack is.
+    /// @param must_skip : whether at least one input token must be skipped
+    /// @return whether parsing can continue
+    bool recover(
+        vector<unsigned>& parse_stack, const vector<uint32_t>& ids,
+        size_t& pos, bool must_skip
+    ) const {
+        const size_t DEPTH = parse_stack.size() - 1;  // Poppable states
+        const size_t SKIPPABLE = ids.size() - 1 - pos;  // Keep '\eof'
+        unsigned work = 0;  // Candidates tried so far
+        vector<unsigned> overlay;  // Scratch states for resumes()
+
+        for (size_t edits = 1;
+             edits <= DEPTH + SKIPPABLE && work < recovery; ++edits) {
+            for (size_t skip = must_skip ? 1 : 0;
+                 skip <= edits && skip <= SKIPPABLE && work < recovery;
+                 ++skip) {
+                size_t pop = edits - skip;
+
+                if (pop > DEPTH) continue;
+
+                ++work;
+
+                size_t at = pos + skip;  // Token to resume on
+                size_t base = DEPTH - pop;  // Candidate's top state
+
+                if (resumes(parse_stack, base, overlay, ids[at])) {
+                    parse_stack.resize(base + 1);
+                    pos = at;
+                    return true;
+                }
+            }
+        }
+
+        // Panic mode, which always makes progress or stops
+        if (SKIPPABLE > 0) {
+            ++pos;
+            return true;
+        }
+
+        if (!must_skip) {
+            for (size_t pop = 1; pop <= DEPTH; ++pop) {
+                unsigned state = parse_stack[parse_stack.size() - 1 - pop];
+
+                if (action_for(ids[pos], state) != 0) {
+                    parse_stack.resize(parse_stack.size() - pop);
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    /// @brief Store the group whose closing token was just shifted
+    static void finish_group(
+        Parse_Cache& cache, const vector<unsigned>& ids,
+        const Span_Hasher& hasher, const string& rrd,
+        const vector<unsigned>& parse_stack, vector<group_t>& groups
+    ) {
+        const group_t& group = groups.back();
+
+        if (group.valid) {
+            cache.insert(
+                group.state, ids, group.open + 1, group.close + 1,
+                hasher.span(group.open + 1, group.close + 1),
+                {
+                    rrd.substr(group.rrd_at),
+                    vector<unsigned>(
+                        parse_stack.begin() + group.height, parse_stack.end()
+                    )
+                }
+            );
+        }
+
+        groups.pop_back();
+    }
+
     // Parser details
     Grammar G;  // The grammar that can be parsed by the LALR parser
 
     // LALR details
-    unordered_map<Token, action_t> actions;  // ACTION table for LALR parsing
-    unordered_map<Token, goto_t> goto_push;  // GOTO table for LALR parsing
+    vector<action_t> actions;  // ACTION table rows, by terminal id
+    vector<goto_t> goto_push;  // GOTO table rows, by nonterminal id
+    vector<rule_t> rules;      // Reduction details for each production
     vector<Token> states;   // Increasing state value identities from G::prods
-    list<unsigned> parse_stack;  // State stack for LALR parsing algorithm
+    unsigned recovery = 0;  // Configurations tried per error; 0 stops parsing
+
+    static const unsigned CONFIRM = 3;  // Shifts before reporting again
 };
 
 #endif /* PARSER_H */
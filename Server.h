@@ -0,0 +1,475 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Cache.h"
+#include "Grammar.h"
+#include "Lexer.h"
+#include "Parser.h"
+
+/// @brief Pre-scoped identifiers
+
+using std::atomic;
+using std::condition_variable;
+using std::cout;
+using std::deque;
+using std::lock_guard;
+using std::map;
+using std::mutex;
+using std::ostringstream;
+using std::shared_ptr;
+using std::string;
+using std::thread;
+using std::unique_ptr;
+using std::unique_lock;
+using std::vector;
+
+/// @typedef reply_t : handle for the response to one parse request, filled in
+///     by a worker and flushed by the event loop in request order
+struct reply_t {
+    string text;               // Response line, including trailing '\n'
+    atomic<bool> done{false};  // Whether a worker has filled in the text
+};
+
+/// @typedef job_t : handle for one parse request waiting on a worker
+struct job_t {
+    string line;              // Input string to lexicate and parse
+    shared_ptr<reply_t> reply;  // Where the worker stores the response
+};
+
+/// @typedef connection_t : handle for one client of the parse server
+struct connection_t {
+    int in_fd;                          // Descriptor requests are read from
+    int out_fd;                         // Descriptor responses are written to
+    string in_buf;                      // Bytes read but not yet a full line
+    string out_buf;                     // Response bytes not yet written
+    deque<shared_ptr<reply_t>> pending;  // Replies in request order
+    bool eof = false;                   // Client has stopped sending requests
+};
+
+/// @typedef Parse_Server : container to serve parse requests from a grammar
+///     and parser that are loaded once for the lifetime of the server
+/// @note Requests are '\n'-delimited input strings; each is answered with one
+///     line, either "OK <reverse rightmost derivation>" or "ERR <message>"
+class Parse_Server {
+public:
+    Parse_Server(
+        const Grammar& g, const LALR_Parser& p, unsigned workers,
+        size_t cache_entries = 0
+    ) : G(g), parser(p) {
+        if (cache_entries != 0) {
+            cache = std::make_unique<Parse_Cache>(g, cache_entries);
+        }
+
+        if (workers == 0) {
+            workers = thread::hardware_concurrency();
+            if (workers == 0) workers = 1;
+        }
+
+        for (unsigned i = 0; i < workers; ++i) {
+            pool.emplace_back(&Parse_Server::work, this);
+        }
+    }
+
+    ~Parse_Server() {
+        {
+            lock_guard<mutex> lock(jobs_mutex);
+            stopping = true;
+        }
+
+        jobs_ready.notify_all();
+
+        for (thread& t : pool) {
+            t.join();
+        }
+
+        if (wake[0] != -1) close(wake[0]);
+        if (wake[1] != -1) close(wake[1]);
+    }
+
+    Parse_Server(const Parse_Server&) = delete;
+    Parse_Server& operator=(const Parse_Server&) = delete;
+
+    /// @brief Lexicate and parse a single request line
+    /// @note The line "\stats" reports the parse cache counters instead
+    string handle(const string& line) const {
+        if (line == "\\stats") {
+            cache_stats_t stats = cache ? cache->stats() : cache_stats_t{};
+
+            return "OK hits=" + to_string(stats.hits)
+                 + " misses=" + to_string(stats.misses)
+                 + " group_hits=" + to_string(stats.group_hits)
+                 + " group_misses=" + to_string(stats.group_misses)
+                 + " entries=" + to_string(stats.entries) + '\n';
+        }
+
+        ostringstream log;  // Diagnostics from the lexer and parser
+        string rrd = parser.parse(lexicate(line, G, log), log, cache.get());
+        string errors = log.str();
+
+        if (errors.empty()) {
+            return "OK " + rrd + '\n';
+        }
+
+        // Fold multi-line diagnostics onto the single response line
+        while (!errors.empty() && errors.back() == '\n') {
+            errors.pop_back();
+        }
+
+        for (char& c : errors) {
+            if (c == '\n') c = ' ';
+        }
+
+        return "ERR " + errors + '\n';
+    }
+
+    /// @brief Serve requests until SIGINT or SIGTERM arrives, or when serving
+    ///     stdin, until stdin is closed and every reply has been written
+    /// @param socket_path : Unix domain socket to listen on, or empty to serve
+    ///     requests from stdin and answer on stdout
+    /// @return integer to operating system
+    int run(const string& socket_path) {
+        signal(SIGPIPE, SIG_IGN);  // Broken clients are handled by write()
+
+        if (pipe(wake) == -1) {
+            cout << "Unable to create server wake pipe: "
+                 << strerror(errno) << '\n';
+            return 1;
+        }
+
+        set_nonblocking(wake[0]);
+        set_nonblocking(wake[1]);
+
+        // Shut down through the wake pipe; no SA_RESTART so poll() returns
+        struct sigaction on_stop{};
+
+        on_stop.sa_handler = request_stop;
+        sigemptyset(&on_stop.sa_mask);
+        stop_requested = 0;
+        stop_fd = wake[1];
+        sigaction(SIGINT, &on_stop, nullptr);
+        sigaction(SIGTERM, &on_stop, nullptr);
+
+        int listen_fd = -1;  // Listening socket, if serving over a socket
+
+        if (socket_path.empty()) {
+            conns[STDIN_FILENO] = {STDIN_FILENO, STDOUT_FILENO, "", "", {}};
+        } else if ((listen_fd = open_socket(socket_path)) == -1) {
+            return 1;
+        }
+
+        while (!stop_requested && (listen_fd != -1 || !conns.empty())) {
+            vector<pollfd> fds;  // Descriptors watched this loop iteration
+
+            fds.push_back({wake[0], POLLIN, 0});
+
+            if (listen_fd != -1) {
+                fds.push_back({listen_fd, POLLIN, 0});
+            }
+
+            for (auto& [id, conn] : conns) {
+                // Stop reading from clients that are not reading their replies
+                bool backlogged = conn.pending.size() >= MAX_PENDING ||
+                                  conn.out_buf.size() >= MAX_OUT_BUF;
+                short in_events  = conn.eof || backlogged ? 0 : POLLIN;
+                short out_events = conn.out_buf.empty() ? 0 : POLLOUT;
+
+                // Idle descriptors are skipped so hangups do not spin the loop
+                if (conn.in_fd == conn.out_fd) {
+                    short events = in_events | out_events;
+                    if (events) fds.push_back({conn.in_fd, events, 0});
+                } else {
+                    if (in_events)  fds.push_back({conn.in_fd, in_events, 0});
+                    if (out_events) fds.push_back({conn.out_fd, out_events, 0});
+                }
+            }
+
+            if (poll(fds.data(), fds.size(), -1) == -1) {
+                if (errno == EINTR) continue;
+
+                cout << "Server poll failed: " << strerror(errno) << '\n';
+                break;
+            }
+
+            for (const pollfd& p : fds) {
+                if (p.revents == 0) continue;
+
+                if (p.fd == wake[0]) {
+                    char drain[64];
+                    while (read(wake[0], drain, sizeof(drain)) > 0) {}
+                } else if (p.fd == listen_fd) {
+                    accept_clients(listen_fd);
+                } else {
+                    service(p);
+                }
+            }
+
+            collect_replies();
+            reap_clients();
+        }
+
+        if (listen_fd != -1) {
+            close(listen_fd);
+            unlink(socket_path.c_str());
+        }
+
+        // Drop clients still connected at shutdown
+        for (auto& [id, conn] : conns) {
+            if (conn.in_fd != STDIN_FILENO) close(conn.in_fd);
+        }
+
+        conns.clear();
+        stop_fd = -1;
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+
+        return 0;
+    }
+
+private:
+    static const size_t MAX_LINE = 1 << 16;  // Longest accepted request line
+    static const size_t MAX_PENDING = 1024;  // Unanswered requests per client
+    static const size_t MAX_OUT_BUF = 1 << 20;  // Unwritten reply bytes
+
+    static inline volatile sig_atomic_t stop_requested = 0;  // Set by signal
+    static inline int stop_fd = -1;  // Wake pipe the signal handler writes to
+
+    static void request_stop(int) {
+        stop_requested = 1;
+
+        char signal_byte = 1;
+        if (stop_fd != -1) (void)!write(stop_fd, &signal_byte, 1);
+    }
+
+    static void set_nonblocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    int open_socket(const string& path) {
+        sockaddr_un addr{};
+
+        if (path.size() >= sizeof(addr.sun_path)) {
+            cout << "Socket path '" << path << "' is too long.\n";
+            return -1;
+        }
+
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path.c_str());
+        unlink(path.c_str());  // Remove a stale socket from a previous run
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (
+            fd == -1 ||
+            bind(fd, (sockaddr*)&addr, sizeof(addr)) == -1 ||
+            listen(fd, SOMAXCONN) == -1
+        ) {
+            cout << "Unable to listen on socket '" << path << "': "
+                 << strerror(errno) << '\n';
+            if (fd != -1) close(fd);
+            return -1;
+        }
+
+        set_nonblocking(fd);
+
+        return fd;
+    }
+
+    void accept_clients(int listen_fd) {
+        int fd;
+
+        while ((fd = accept(listen_fd, nullptr, nullptr)) != -1) {
+            set_nonblocking(fd);
+            conns[fd] = {fd, fd, "", "", {}};
+        }
+    }
+
+    void service(const pollfd& p) {
+        // Find the client owning this descriptor (stdin/stdout are split)
+        auto it = conns.find(p.fd);
+
+        if (it == conns.end()) {
+            it = conns.begin();
+            while (it != conns.end() && it->second.out_fd != p.fd) ++it;
+            if (it == conns.end()) return;
+        }
+
+        connection_t& conn = it->second;
+
+        if (p.fd == conn.in_fd && (p.revents & (POLLIN | POLLHUP | POLLERR))) {
+            receive(conn);
+        }
+
+        if (p.fd == conn.out_fd && (p.revents & POLLOUT)) {
+            flush(conn);
+        }
+    }
+
+    void receive(connection_t& conn) {
+        char chunk[4096];
+        ssize_t n = read(conn.in_fd, chunk, sizeof(chunk));
+
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+
+        if (n <= 0) {
+            conn.eof = true;
+
+            // Treat an unterminated final line as a request
+            if (!conn.in_buf.empty()) submit(conn, conn.in_buf);
+            conn.in_buf.clear();
+
+            return;
+        }
+
+        conn.in_buf.append(chunk, n);
+
+        size_t start = 0;  // Start of the next unprocessed line
+        size_t end;        // Position of the '\n' ending that line
+
+        while ((end = conn.in_buf.find('\n', start)) != string::npos) {
+            submit(conn, conn.in_buf.substr(start, end - start));
+            start = end + 1;
+        }
+
+        conn.in_buf.erase(0, start);
+
+        if (conn.in_buf.size() > MAX_LINE) {
+            auto reply = std::make_shared<reply_t>();
+            reply->text = "ERR Request exceeds " + to_string(MAX_LINE)
+                        + " bytes.\n";
+            reply->done = true;
+            conn.pending.push_back(reply);
+            conn.in_buf.clear();
+            conn.eof = true;  // Cannot resynchronize on a line boundary
+        }
+    }
+
+    void submit(connection_t& conn, string line) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+
+        auto reply = std::make_shared<reply_t>();
+        conn.pending.push_back(reply);
+
+        {
+            lock_guard<mutex> lock(jobs_mutex);
+            jobs.push_back({std::move(line), reply});
+        }
+
+        jobs_ready.notify_one();
+    }
+
+    void flush(connection_t& conn) {
+        while (!conn.out_buf.empty()) {
+            ssize_t n;
+
+            if (conn.in_fd == conn.out_fd) {
+                n = send(conn.out_fd, conn.out_buf.data(), conn.out_buf.size(),
+                         MSG_NOSIGNAL);
+            } else {
+                n = write(conn.out_fd, conn.out_buf.data(), conn.out_buf.size());
+            }
+
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN) return;
+
+                // Client went away; drop anything it would have received
+                conn.out_buf.clear();
+                conn.pending.clear();
+                conn.eof = true;
+                return;
+            }
+
+            conn.out_buf.erase(0, n);
+        }
+    }
+
+    void collect_replies() {
+        // Move finished replies to output buffers without reordering them
+        for (auto& [id, conn] : conns) {
+            while (!conn.pending.empty() && conn.pending.front()->done) {
+                conn.out_buf += conn.pending.front()->text;
+                conn.pending.pop_front();
+            }
+        }
+    }
+
+    void reap_clients() {
+        auto it = conns.begin();
+
+        while (it != conns.end()) {
+            connection_t& conn = it->second;
+
+            if (conn.eof && conn.pending.empty() && conn.out_buf.empty()) {
+                if (conn.in_fd != STDIN_FILENO) close(conn.in_fd);
+                it = conns.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void work() {
+        while (true) {
+            job_t job;
+
+            {
+                unique_lock<mutex> lock(jobs_mutex);
+                jobs_ready.wait(lock, [this] {
+                    return stopping || !jobs.empty();
+                });
+
+                if (jobs.empty()) return;  // Stopping with no work left
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            job.reply->text = handle(job.line);
+            job.reply->done = true;
+
+            // Wake the event loop so the reply can be flushed
+            char signal_byte = 1;
+            (void)!write(wake[1], &signal_byte, 1);
+        }
+    }
+
+    // Loaded once for the lifetime of the server
+    const Grammar& G;            // Grammar used to lexicate requests
+    const LALR_Parser& parser;   // Parser used to answer requests
+    unique_ptr<Parse_Cache> cache;  // Results of repeated inputs, if enabled
+
+    // Worker pool details
+    vector<thread> pool;         // Threads running work()
+    deque<job_t> jobs;           // Requests waiting on a worker
+    mutex jobs_mutex;            // Guards jobs and stopping
+    condition_variable jobs_ready;  // Signalled when jobs gains an entry
+    bool stopping = false;       // Workers should exit once jobs is empty
+
+    // Event loop details
+    map<int, connection_t> conns;  // Clients keyed by their input descriptor
+    int wake[2] = {-1, -1};        // Pipe used by workers to wake the loop
+};
+
+#endif /* SERVER_H */
+
+/* EOF */
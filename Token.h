@@ -1,12 +1,17 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 /// @brief Pre-scoped identifiers
 
 using std::string;
+using std::to_string;
+using std::vector;
 
 /// @typedef token_t : handle for classifying a token
 struct token_t {
@@ -19,6 +24,7 @@ struct Token {
     string   ident;      // Physical string of token
     bool     terminal;   // Whether the token is terminal or nonterminal
     unsigned table_idx;  // Index of token into terminal/nonterminal token list
+    size_t   offset = 0; // Byte offset in the lexicated input (input only)
 
     bool operator==(const Token& rhs) const {
         return ident == rhs.ident && terminal == rhs.terminal &&
@@ -36,6 +42,78 @@ struct std::hash<Token>
     }
 };
 
+/// @typedef location_t : 1-based line and column of a byte in an input string
+struct location_t {
+    uint32_t line;    // Line number, counting '\n' characters
+    uint32_t column;  // Byte column within the line
+};
+
+/// @typedef Token_Buffer : lexer output kept as parallel arrays, so the parser
+///     can stream over a dense array of terminal ids
+/// @note Clearing keeps the capacity of every array, so a buffer reused across
+///     inputs stops allocating once it has seen its largest input. Line starts
+///     are indexed separately; a token's line and column are only computed
+///     when a diagnostic asks for them.
+class Token_Buffer {
+public:
+    vector<uint32_t> ids;      // Terminal id of each token ('\eof' is last)
+    vector<uint32_t> offsets;  // Byte offset of each token in the input
+    vector<uint32_t> lengths;  // Byte length of each token in the input
+
+    void clear() {
+        ids.clear();
+        offsets.clear();
+        lengths.clear();
+        line_starts.clear();
+    }
+
+    void push_back(uint32_t id, size_t offset, size_t length) {
+        ids.push_back(id);
+        offsets.push_back((uint32_t)offset);
+        lengths.push_back((uint32_t)length);
+    }
+
+    size_t size() const {
+        return ids.size();
+    }
+
+    /// @brief Record where each line of the input starts
+    void index_lines(const string& input) {
+        line_starts.push_back(0);
+
+        for (size_t i = input.find('\n'); i != string::npos;
+             i = input.find('\n', i + 1)) {
+            line_starts.push_back((uint32_t)i + 1);
+        }
+    }
+
+    /// @brief Line and column of a byte offset in the indexed input
+    location_t locate(size_t offset) const {
+        auto next = std::upper_bound(
+            line_starts.begin(), line_starts.end(), (uint32_t)offset
+        );
+        size_t line = next - line_starts.begin();  // Lines starting at or before
+
+        if (line == 0) return {1, (uint32_t)offset + 1};
+
+        return {(uint32_t)line, (uint32_t)(offset - *(next - 1)) + 1};
+    }
+
+    /// @brief Line and column of the token at a position
+    location_t location(size_t token) const {
+        return locate(offsets.at(token));
+    }
+
+    /// @brief Name a byte offset the way diagnostics present it
+    string describe(size_t offset) const {
+        location_t at = locate(offset);
+        return "line " + to_string(at.line) + ", column " + to_string(at.column);
+    }
+
+private:
+    vector<uint32_t> line_starts;  // Byte offset where each line begins
+};
+
 #endif /* TOKEN_H */
 
 /* EOF */